@@ -0,0 +1,47 @@
+#include <metaqueue.hpp>
+
+struct mySimpleStruct{
+    int id;
+    char name[32];
+    char value;
+
+    void set(int _id, std::string _name, char _value){
+        id=_id;
+        std::memset(name, 0, sizeof(name));
+        std::memcpy(name, _name.c_str(), _name.size());
+        value=_value;
+    }
+
+    void print(){
+        std::cout << "id:" << id << std::endl;
+        std::cout << "name:" << name << std::endl;
+        std::cout << "another_important_value:" << value << std::endl;
+    }
+};
+
+//List the fields which will be sent, the padding is elided, the id is varint encoded and the name is trimmed to its used length.
+METAQUEUE_COMPACT_LAYOUT(mySimpleStruct, &mySimpleStruct::id, &mySimpleStruct::name, &mySimpleStruct::value)
+
+int main(){
+    //A simple structure(No custom constructor, neither destructor, no pointers)
+    mySimpleStruct my_struct;
+    my_struct.set(8, "Your Name Here", 'R');
+
+    //Compare the size of the message against the raw structure.
+    char encoded[QueueMetafunctions::compact_codec<mySimpleStruct>::max_size];
+    std::cout << "raw bytes:" << sizeof(mySimpleStruct) << " compact bytes:" << QueueMetafunctions::compact_codec<mySimpleStruct>::encode(my_struct, encoded) << std::endl;
+
+    //Creating the Queue, the argument is the name of the queue.
+    metaqueue<mySimpleStruct> myqueue("myQueueCompact");
+
+    //Enqueue the data into a single message and sent it to the queue, the compact encoding is used automatically.
+    myqueue.enqueue(my_struct);
+
+    //Recover the value from the queue.
+    auto my_dequeued_value = myqueue.dequeue();
+
+    //Print the result
+    my_dequeued_value.print();
+
+    return 0;
+}
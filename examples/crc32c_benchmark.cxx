@@ -0,0 +1,99 @@
+#include <metaqueue.hpp>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+//Same payload as std::string, but the messages are framed with a CRC32C.
+struct framedString : public std::string{
+    using std::string::string;
+    framedString() = default;
+    framedString(const char *data, size_t size) : std::string(data, size){}
+};
+METAQUEUE_FRAMED_MESSAGE(framedString, 1)
+
+//Queues big enough for the largest payload plus the frame header.
+template <typename S>
+using benchmarkQueue = metaqueue<S, METAQUEUE_DEFAULT_QUEUE_PERMISSION, METAQUEUE_DEFAULT_MAX_MESSAGES, 8192>;
+
+static double seconds_since(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double median(std::vector<double> values){
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+//Measure the CRC32C speed alone and return the nanoseconds per payload.
+template <typename F>
+static double crc_speed(F crc, const std::string &payload, int rounds){
+    uint32_t result = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++){
+        result += crc(payload.data(), payload.size());
+    }
+    double elapsed = seconds_since(start);
+    if (result == 1){
+        std::cout << "unlikely" << std::endl;
+    }
+    return elapsed / rounds * 1e9;
+}
+
+//Push and pop messages through the queue and return the nanoseconds per round trip.
+template <typename S>
+static double round_trip(benchmarkQueue<S> &myqueue, const std::string &payload, int messages){
+    S message(payload.data(), payload.size());
+    size_t received = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < messages; i++){
+        myqueue.enqueue(message);
+        received += myqueue.dequeue().size();
+    }
+    double elapsed = seconds_since(start);
+    if (received != payload.size() * messages){
+        std::cout << "lost data" << std::endl;
+    }
+    return elapsed / messages * 1e9;
+}
+
+int main(){
+    const int messages = 20000;
+    const int repetitions = 11;
+
+    benchmarkQueue<std::string> plain_queue("myQueueCrcPlain");
+    benchmarkQueue<framedString> framed_queue("myQueueCrcFramed");
+
+    for (size_t size : {64, 1024, 8000}){
+        std::string payload(size, 'x');
+        for (size_t i = 0; i < payload.size(); i++){
+            payload[i] = (char)(i * 131);
+        }
+
+        double crc_ns = crc_speed([](const char *data, size_t size){ return QueueMetafunctions::crc32c(data, size); }, payload, 200000);
+        double software_ns = crc_speed([](const char *data, size_t size){ return ~QueueMetafunctions::crc32c_software(~0u, data, size); }, payload, 20000);
+
+        //Warm up both paths, then interleave the runs so a noisy period hits both of them.
+        round_trip(plain_queue, payload, messages);
+        round_trip(framed_queue, payload, messages);
+        std::vector<double> plain, framed;
+        for (int i = 0; i < repetitions; i++){
+            plain.push_back(round_trip(plain_queue, payload, messages));
+            framed.push_back(round_trip(framed_queue, payload, messages));
+        }
+        double plain_ns = median(plain);
+        double framed_ns = median(framed);
+
+        std::cout << size << " bytes:" << std::endl;
+        std::cout << "  crc32c:" << size / crc_ns << "GB/s " << crc_ns << "ns (software " << size / software_ns << "GB/s)" << std::endl;
+        std::cout << "  round trip plain:" << plain_ns << "ns framed:" << framed_ns << "ns (median of " << repetitions << ")" << std::endl;
+        std::cout << "  measured framing cost:" << (framed_ns - plain_ns) / plain_ns * 100 << "%" << std::endl;
+        //The CRC runs on the send and on the receive of every message.
+        std::cout << "  crc share of the round trip:" << 2 * crc_ns / framed_ns * 100 << "%" << std::endl;
+    }
+
+    plain_queue.unlink();
+    framed_queue.unlink();
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include <metaqueue.hpp>
+
+//Non blocking queue of 2 messages whose operations return their status instead of printing or throwing.
+using myStatusQueue = metaqueue<int, METAQUEUE_DEFAULT_QUEUE_PERMISSION, 2, 64, O_NONBLOCK, QueueMetafunctions::status_errors>;
+
+int main(){
+    //Creating the Queue, the argument is the name of the queue.
+    myStatusQueue myqueue("myQueueStatus");
+
+    //Enqueue more messages than the queue can hold, the failures are cheap, no allocation and no I/O.
+    for (int i = 0; i < 4; i++){
+        auto status = myqueue.enqueue(i);
+        if (!status){
+            std::cout << "queue full, error:" << status.error << std::endl;
+        }
+    }
+
+    //Recover the values until the queue is empty.
+    while (auto result = myqueue.dequeue()){
+        std::cout << result.value << std::endl;
+    }
+
+    //Print how many operations failed, the read of the empty queue is not a failure.
+    std::cout << "failures:" << myqueue.error_count() << " last error:" << myqueue.last_error() << std::endl;
+    std::cout << "empty reads:" << myqueue.empty_count() << std::endl;
+
+    myqueue.unlink();
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <metaqueue.hpp>
+#include <chrono>
+#include <thread>
+
+int main(){
+    //Creating the Queue, the argument is the name of the queue.
+    metaqueue<int> myqueue("myQueueEvents");
+
+    //Register a callback, it will be executed for every message without a thread waiting in the queue.
+    myqueue.on_message([](int &value){
+        std::cout << "received:" << value << std::endl;
+    });
+
+    //Enqueue some messages, the OS will notify the arrival and the callback drains them.
+    for (int i = 0; i < 5; i++){
+        myqueue.enqueue(i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    //Stop receiving notifications.
+    myqueue.off_message();
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <metaqueue.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+//Message carrying the time it was sent.
+struct timestampMessage{
+    long long sent_ns;
+};
+
+static long long now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//CPUs where this process is allowed to run.
+static std::vector<int> allowed_cpus(){
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0){
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+            if (CPU_ISSET(cpu, &set)){
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+//Send messages with a small gap between them and measure how long the consumer takes to see each one.
+static void run(QueueMetafunctions::receive_mode mode, const char *label, int messages, int gap_us){
+    metaqueue<timestampMessage> myqueue("myQueueLatency");
+    myqueue.set_receive_mode(mode);
+
+    std::vector<long long> latencies;
+    latencies.reserve(messages);
+
+    //Producer and consumer on different CPUs, the spinning consumer must not steal the CPU of the producer.
+    auto cpus = allowed_cpus();
+    bool pinned = cpus.size() > 1;
+
+    std::thread consumer([&](){
+        if (pinned){
+            myqueue.pin_consumer({cpus[1]});
+        }
+        for (int i = 0; i < messages; i++){
+            auto message = myqueue.dequeue();
+            latencies.push_back(now_ns() - message.sent_ns);
+        }
+    });
+
+    if (pinned){
+        QueueMetafunctions::pin_thread({cpus[0]});
+    }
+    for (int i = 0; i < messages; i++){
+        std::this_thread::sleep_for(std::chrono::microseconds(gap_us));
+        timestampMessage message{now_ns()};
+        myqueue.enqueue(message);
+    }
+    consumer.join();
+    if (pinned){
+        QueueMetafunctions::pin_thread(cpus);
+    }
+    myqueue.unlink();
+
+    std::sort(latencies.begin(), latencies.end());
+    long long total = 0;
+    for (auto latency : latencies){
+        total += latency;
+    }
+    std::cout << label
+              << " avg:" << total / messages / 1000.0 << "us"
+              << " p50:" << latencies[messages / 2] / 1000.0 << "us"
+              << " p99:" << latencies[messages * 99 / 100] / 1000.0 << "us"
+              << " spin_budget:" << myqueue.spin_budget() << std::endl;
+}
+
+int main(){
+    const int messages = 10000;
+    const int gap_us = 20;
+
+    if (allowed_cpus().size() < 2){
+        std::cout << "note: only one CPU available, producer and consumer share it so spinning delays the producer and the spin mode can not beat the blocking mode." << std::endl;
+    }
+
+    run(QueueMetafunctions::receive_mode::blocking, "blocking", messages, gap_us);
+    run(QueueMetafunctions::receive_mode::spin, "spin    ", messages, gap_us);
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <metaqueue.hpp>
+#include <string>
+
+int main(){
+    //A std string
+    std::string my_favourite_string("Hello World From Mexico!");
+
+    //Creating the Queue, the depth is the deepest the host allows and the buffer is allocated with the real message size.
+    runtime_metaqueue<std::string> myqueue("myQueueRuntime");
+
+    //Print the attributes chosen for this host.
+    std::cout << "max messages:" << myqueue.max_messages() << " max message size:" << myqueue.max_message_size() << std::endl;
+
+    //Enqueue the data into a single message and sent it to the queue.
+    myqueue.enqueue(my_favourite_string);
+
+    //Recover the value from the queue.
+    auto my_dequeued_value = myqueue.dequeue();
+
+    //Print the result
+    std::cout << my_dequeued_value << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <metaqueue_worker_pool.hpp>
+#include <atomic>
+
+int main(){
+    //Names of the queues, one per tenant.
+    std::vector<std::string> names = {"myQueueTenantA", "myQueueTenantB", "myQueueTenantC"};
+
+    //The producers, tenants A and B are hot and tenant C is idle.
+    metaqueue<int> hot_queue_a("myQueueTenantA");
+    metaqueue<int> hot_queue_b("myQueueTenantB");
+
+    //Count the consumed messages.
+    std::atomic<long> total(0);
+    unsigned long steals = 0;
+
+    {
+        //Consume all the queues with 4 threads, the messages of the same queue keep their order.
+        metaqueue_worker_pool<int> pool(names, [&](int &value){
+            //Some work per message, so the batches wait long enough in the deques to be stolen.
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            total += value;
+        }, 4, QueueMetafunctions::pool_ordering::strict_fifo);
+
+        //Enqueue the data, the workers consume it meanwhile.
+        for (int i = 1; i <= 1000; i++){
+            hot_queue_a.enqueue(i);
+            hot_queue_b.enqueue(i);
+        }
+
+        //Wait until the queues are empty and stop the workers.
+        while (hot_queue_a.count() > 0 || hot_queue_b.count() > 0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        pool.stop();
+        steals = pool.steal_count();
+    }
+
+    //Print the result
+    std::cout << "sum:" << total << std::endl;
+    std::cout << "steals:" << steals << std::endl;
+
+    hot_queue_a.unlink();
+    hot_queue_b.unlink();
+
+    return 0;
+}
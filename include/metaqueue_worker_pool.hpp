@@ -0,0 +1,363 @@
+/**
+ * @file metaqueue_worker_pool.hpp
+ * @author Eric Octavio Rodriguez Garcia (eric.rodriguezg@elektra.com.mx)
+ * @brief Pool of worker threads which consume a set of metaqueues. Each worker drains the queues in
+ * batches into its own deque and the idle workers steal batches from the busy ones, so the throughput
+ * scales with the number of cores instead of the number of queues.
+ * @version 0.0.1
+ * @date 2022-11-25
+ *
+ * @copyright Copyright (Eric Octavio Rodriguez Garcia) GPL - 2022.
+ *
+ */
+#pragma once
+#include <metaqueue.hpp>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <thread>
+
+#ifndef METAQUEUE_DEFAULT_POOL_BATCH_SIZE
+    #define METAQUEUE_DEFAULT_POOL_BATCH_SIZE 32      //> Maximum number of messages a worker reads from a queue at once.
+#endif
+
+#ifndef METAQUEUE_DEFAULT_POOL_MAX_IDLE_SLEEP_US
+    #define METAQUEUE_DEFAULT_POOL_MAX_IDLE_SLEEP_US 1000 //> Maximum time in microseconds an idle worker sleeps before looking for work again.
+#endif
+
+namespace QueueMetafunctions
+{
+    /**
+     * @brief Ordering guarantees of the messages consumed by a worker pool.
+     *
+     */
+    enum class pool_ordering
+    {
+        strict_fifo, //> Messages of the same queue are handled one after the other, in the order they were dequeued.
+        unordered    //> Messages of the same queue can be handled by several workers at the same time.
+    };
+}; // namespace QueueMetafunctions
+
+/**
+ * @brief This class will consume a set of queues with a fixed number of threads. The handler is executed once for each message.
+ *
+ * @tparam T Datatype which the queues will be working with.
+ * @tparam QueuePermission Permission of the queues, default 0660, User,Group(Read+Write)
+ * @tparam MaxMessages Max number of enqueued messages, default 10.
+ * @tparam MaxMessageSize Max size of the message in bytes.
+ * @tparam QueueFlags Extra Queue flags.
+ */
+template <typename T = std::void_t<>,
+          int QueuePermission = METAQUEUE_DEFAULT_QUEUE_PERMISSION,
+          int MaxMessages = METAQUEUE_DEFAULT_MAX_MESSAGES,
+          int MaxMessageSize = METAQUEUE_DEFAULT_MAX_MESSAGE_SIZE,
+          int QueueFlags = METAQUEUE_DEFAULT_QUEUE_FLAGS>
+class metaqueue_worker_pool
+{
+    using queue_type = metaqueue<T, QueuePermission, MaxMessages, MaxMessageSize, QueueFlags>; //> Type of the consumed queues.
+    typedef typename QueueMetafunctions::get_datatype<T>::type value_type;                     //> Value type depending on the input.
+    typedef std::function<void(value_type &)> handler_type;                                    //> Callback executed for each message.
+
+    /**
+     * @brief Queue consumed by the pool, the flag makes sure only one worker reads it at the same time.
+     *
+     */
+    struct source
+    {
+        std::unique_ptr<queue_type> queue;             //> The queue.
+        std::atomic_flag claimed = ATOMIC_FLAG_INIT;   //> Set while a worker owns the queue.
+    };
+
+    /**
+     * @brief Set of messages dequeued from the same queue, the messages before next were already taken.
+     *
+     */
+    struct batch
+    {
+        size_t source_index;              //> Index of the queue where the messages come from.
+        std::vector<value_type> messages; //> Messages in dequeue order.
+        size_t next = 0;                  //> Index of the next message to handle.
+        bool started = false;             //> The owner already took messages of this batch.
+    };
+
+    /**
+     * @brief Local deque of a worker, the owner takes the messages of the newest batch and the thieves take the oldest batches.
+     *
+     */
+    struct worker
+    {
+        std::mutex lock;           //> Protects the deque.
+        std::deque<batch> batches; //> Pending batches.
+    };
+
+private:
+    handler_type handler;                            //> Callback executed for each message.
+    QueueMetafunctions::pool_ordering ordering;      //> Ordering guarantees of the messages.
+    size_t batch_size;                               //> Maximum number of messages read from a queue at once.
+    std::vector<std::unique_ptr<source>> sources;    //> Consumed queues.
+    std::vector<std::unique_ptr<worker>> workers;    //> Local deques of the workers.
+    std::vector<std::thread> threads;                //> Worker threads.
+    std::atomic<bool> running;                       //> Workers keep looking for work while true.
+    std::atomic<unsigned long> steals;               //> Number of batches or half batches taken from another worker.
+
+    /**
+     * @brief Execute the handler for a message and release its queue if it was the last message of a strict batch.
+     *
+     * @param message Message to be handled.
+     * @param source_index Index of the queue where the message comes from.
+     * @param last The message was the last one of its batch.
+     */
+    void handle(value_type &message, size_t source_index, bool last)
+    {
+        try
+        {
+            handler(message);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << '\n';
+        }
+
+        if (last && ordering == QueueMetafunctions::pool_ordering::strict_fifo)
+        {
+            sources[source_index]->claimed.clear(std::memory_order_release);
+        }
+    }
+
+    /**
+     * @brief Take the next message of the newest batch of the worker deque, the rest of the batch stays in the deque so it can be stolen.
+     *
+     * @param id Worker index.
+     * @param message Where the message will be moved.
+     * @param source_index Index of the queue where the message comes from.
+     * @param last Set to true if the message was the last one of its batch.
+     * @return true A message was taken.
+     * @return false The deque is empty.
+     */
+    bool take_local(size_t id, value_type &message, size_t &source_index, bool &last)
+    {
+        std::lock_guard<std::mutex> guard(workers[id]->lock);
+        if (workers[id]->batches.empty())
+        {
+            return false;
+        }
+
+        batch &newest = workers[id]->batches.back();
+        newest.started = true;
+        message = std::move(newest.messages[newest.next++]);
+        source_index = newest.source_index;
+        last = newest.next == newest.messages.size();
+        if (last)
+        {
+            workers[id]->batches.pop_back();
+        }
+        return true;
+    }
+
+    /**
+     * @brief Read a batch from every queue which is free and has messages, starting after the last queue the worker visited.
+     *
+     * @param id Worker index.
+     * @param cursor Index of the next queue to visit, it is updated so the queues are visited round robin.
+     * @return true At least one batch was added to the worker deque.
+     * @return false All the queues are empty or owned by other workers.
+     */
+    bool fill_local(size_t id, size_t &cursor)
+    {
+        bool filled = false;
+        size_t start = cursor;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            size_t index = (start + i) % sources.size();
+            source &current = *sources[index];
+            if (current.claimed.test_and_set(std::memory_order_acquire))
+            {
+                continue;
+            }
+
+            batch work;
+            work.source_index = index;
+            current.queue->pop_batch(work.messages, batch_size);
+            if (work.messages.empty() || ordering == QueueMetafunctions::pool_ordering::unordered)
+            {
+                current.claimed.clear(std::memory_order_release);
+            }
+            if (work.messages.empty())
+            {
+                continue;
+            }
+
+            // A strict batch keeps the queue claimed until its last message is handled, so the next batch of this queue can not overtake it.
+            cursor = index + 1;
+            filled = true;
+            std::lock_guard<std::mutex> guard(workers[id]->lock);
+            workers[id]->batches.push_back(std::move(work));
+        }
+        return filled;
+    }
+
+    /**
+     * @brief Move work of another worker to the thief deque. The oldest batch not started by its owner is taken whole, in unordered mode a started batch is split and the thief takes the second half of the remaining messages.
+     *
+     * @param id Thief worker index.
+     * @return true Work was stolen.
+     * @return false No worker had work to steal.
+     */
+    bool steal(size_t id)
+    {
+        for (size_t i = 1; i < workers.size(); i++)
+        {
+            batch work;
+            {
+                worker &victim = *workers[(id + i) % workers.size()];
+                std::lock_guard<std::mutex> guard(victim.lock);
+                auto found = victim.batches.begin();
+                while (found != victim.batches.end() && found->started)
+                {
+                    found++;
+                }
+
+                if (found != victim.batches.end())
+                {
+                    work = std::move(*found);
+                    victim.batches.erase(found);
+                }
+                else if (ordering == QueueMetafunctions::pool_ordering::unordered && !victim.batches.empty() &&
+                         victim.batches.front().messages.size() - victim.batches.front().next > 1)
+                {
+                    batch &oldest = victim.batches.front();
+                    size_t half = oldest.next + (oldest.messages.size() - oldest.next) / 2;
+                    work.source_index = oldest.source_index;
+                    work.messages.assign(std::make_move_iterator(oldest.messages.begin() + half), std::make_move_iterator(oldest.messages.end()));
+                    oldest.messages.resize(half);
+                }
+                else
+                {
+                    continue;
+                }
+            }
+
+            steals.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> guard(workers[id]->lock);
+            workers[id]->batches.push_front(std::move(work));
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Main loop of a worker, look for work in its own deque, then in the queues and then in the other workers. An idle worker sleeps with an exponential back off.
+     *
+     * @param id Worker index.
+     */
+    void run(size_t id)
+    {
+        size_t cursor = id;
+        unsigned int idle_sleep_us = 1;
+        value_type message;
+        size_t source_index;
+        bool last;
+        while (running.load(std::memory_order_relaxed))
+        {
+            if (take_local(id, message, source_index, last) ||
+                ((fill_local(id, cursor) || steal(id)) && take_local(id, message, source_index, last)))
+            {
+                handle(message, source_index, last);
+                idle_sleep_us = 1;
+                continue;
+            }
+
+            std::this_thread::sleep_for(std::chrono::microseconds(idle_sleep_us));
+            idle_sleep_us = (idle_sleep_us * 2 > METAQUEUE_DEFAULT_POOL_MAX_IDLE_SLEEP_US) ? METAQUEUE_DEFAULT_POOL_MAX_IDLE_SLEEP_US : idle_sleep_us * 2;
+        }
+
+        // Messages already dequeued must not be lost.
+        while (take_local(id, message, source_index, last))
+        {
+            handle(message, source_index, last);
+        }
+    }
+
+public:
+    /**
+     * @brief Construct a new metaqueue_worker_pool object, the workers start consuming the queues immediately.
+     *
+     * @param queue_names Names of the queues to consume.
+     * @param _handler Callback executed for each message, it runs in the worker threads.
+     * @param number_of_workers Number of threads, default the number of cores.
+     * @param _ordering Ordering guarantees of the messages of the same queue, default strict FIFO.
+     * @param _batch_size Maximum number of messages a worker reads from a queue at once.
+     */
+    metaqueue_worker_pool(const std::vector<std::string> &queue_names,
+                          handler_type _handler,
+                          size_t number_of_workers = std::thread::hardware_concurrency(),
+                          QueueMetafunctions::pool_ordering _ordering = QueueMetafunctions::pool_ordering::strict_fifo,
+                          size_t _batch_size = METAQUEUE_DEFAULT_POOL_BATCH_SIZE)
+        : handler(std::move(_handler)), ordering(_ordering), batch_size(_batch_size == 0 ? 1 : _batch_size), running(true), steals(0)
+    {
+        for (const auto &name : queue_names)
+        {
+            sources.emplace_back(new source());
+            sources.back()->queue.reset(new queue_type(name));
+        }
+
+        if (number_of_workers == 0)
+        {
+            number_of_workers = 1;
+        }
+        for (size_t i = 0; i < number_of_workers; i++)
+        {
+            workers.emplace_back(new worker());
+        }
+        for (size_t i = 0; i < number_of_workers; i++)
+        {
+            threads.emplace_back(&metaqueue_worker_pool::run, this, i);
+        }
+    }
+
+    /**
+     * @brief Destroy the metaqueue_worker_pool object, stops the workers.
+     *
+     */
+    ~metaqueue_worker_pool()
+    {
+        stop();
+    }
+
+    /**
+     * @brief Stop the workers and wait for them, the messages already dequeued are handled before the workers finish.
+     *
+     */
+    void stop()
+    {
+        running = false;
+        for (auto &thread : threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+    }
+
+    /**
+     * @brief Number of worker threads.
+     *
+     * @return size_t Number of worker threads.
+     */
+    size_t size()
+    {
+        return workers.size();
+    }
+
+    /**
+     * @brief Number of times a worker took work from another worker.
+     *
+     * @return unsigned long Number of steals.
+     */
+    unsigned long steal_count()
+    {
+        return steals.load(std::memory_order_relaxed);
+    }
+};